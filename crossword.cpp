@@ -4,9 +4,122 @@
 #include <string>
 #include <utility>
 #include <iostream>
+#include <sstream>
 #include <algorithm>
 #include <limits>
 #include <chrono>
+#include <random>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <numeric>
+#include <memory>
+#include <array>
+#include <list>
+#include <unordered_map>
+#include <stdexcept>
+#include <cstdint>
+#include <cstdlib>
+#include <cstdio>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <fstream>
+
+// Building with -DCROSSWORD_PROFILE times every PROFILE_SCOPE and makes main()
+// run the profiling workloads instead of the tests and the normal search.
+#ifdef CROSSWORD_PROFILE
+// Call tree of the profiled scopes of one thread. Names are compared by
+// pointer, so they must be string literals.
+struct ProfileNode {
+	ProfileNode(const char* name, ProfileNode* parent)
+	: name(name), parent(parent), nanoseconds(0), calls(0) {
+	}
+	ProfileNode* child(const char* childName) {
+		for (const std::unique_ptr<ProfileNode>& c : children) {
+			if (c->name == childName) {
+				return c.get();
+			}
+		}
+		children.emplace_back(new ProfileNode(childName, this));
+		return children.back().get();
+	}
+	const char* name;
+	ProfileNode* parent;
+	std::vector<std::unique_ptr<ProfileNode>> children;
+	uint64_t nanoseconds;
+	uint64_t calls;
+};
+
+// Owns the call trees of all threads, so that they outlive their threads.
+class Profiler {
+public:
+	static Profiler& instance() {
+		static Profiler profiler;
+		return profiler;
+	}
+	static ProfileNode*& current() {
+		thread_local ProfileNode* node = instance().addThread();
+		return node;
+	}
+	// Writes one line "frame;frame;... selfNanoseconds" per call stack, as
+	// expected by flamegraph.pl.
+	void writeFolded(std::ostream& out) {
+		std::lock_guard<std::mutex> lock(_mutex);
+		for (const std::unique_ptr<ProfileNode>& root : _roots) {
+			writeFolded(out, *root, root->name);
+		}
+	}
+private:
+	ProfileNode* addThread() {
+		std::lock_guard<std::mutex> lock(_mutex);
+		_names.push_back("thread-" + std::to_string(_roots.size()));
+		_roots.emplace_back(new ProfileNode(_names.back().c_str(), nullptr));
+		return _roots.back().get();
+	}
+	void writeFolded(std::ostream& out, const ProfileNode& node,
+			const std::string& stack) {
+		uint64_t childNanoseconds = 0;
+		for (const std::unique_ptr<ProfileNode>& c : node.children) {
+			childNanoseconds += c->nanoseconds;
+			writeFolded(out, *c, stack + ';' + c->name);
+		}
+		if (node.nanoseconds > childNanoseconds) {
+			out << stack << ' ' << node.nanoseconds - childNanoseconds << '\n';
+		}
+	}
+
+	std::mutex _mutex;
+	std::list<std::string> _names;
+	std::vector<std::unique_ptr<ProfileNode>> _roots;
+};
+
+class ProfileScope {
+public:
+	ProfileScope(const char* name)
+	: _node(Profiler::current()->child(name)),
+	  _start(std::chrono::steady_clock::now()) {
+		Profiler::current() = _node;
+	}
+	ProfileScope(const ProfileScope&) = delete;
+	ProfileScope& operator=(const ProfileScope&) = delete;
+	~ProfileScope() {
+		_node->nanoseconds += std::chrono::duration_cast<
+				std::chrono::nanoseconds>(std::chrono::steady_clock::now() -
+						_start).count();
+		_node->calls++;
+		Profiler::current() = _node->parent;
+	}
+private:
+	ProfileNode* _node;
+	std::chrono::steady_clock::time_point _start;
+};
+
+#define PROFILE_SCOPE(name) ProfileScope profileScope(name)
+#else
+#define PROFILE_SCOPE(name)
+#endif
 
 class WordWithDirection {
 public:
@@ -100,14 +213,62 @@ private:
 	int _yStart;
 };
 
+// The characters of all words covering one cell. Only up to three entries are
+// stored, because a valid puzzle never has more than two words in one cell.
+class CellCharacters {
+public:
+	using CharacterInWord = std::pair<char, const Crossword*>;
+	static const size_t CAPACITY = 3;
+
+	CellCharacters()
+	: _size(0) {
+	}
+	void push_back(const CharacterInWord& ciw) {
+		if (_size < CAPACITY) {
+			_characters[_size] = ciw;
+		}
+		_size++;
+	}
+	void clear() {
+		_size = 0;
+	}
+	size_t size() const {
+		return _size;
+	}
+	const CharacterInWord& operator[](size_t i) const {
+		return _characters[i];
+	}
+	const CharacterInWord* begin() const {
+		return _characters;
+	}
+	const CharacterInWord* end() const {
+		return _characters + (_size < CAPACITY ? _size : CAPACITY);
+	}
+private:
+	CharacterInWord _characters[CAPACITY];
+	size_t _size;
+};
+
 class CrosswordPuzzle : public std::vector<Crossword> {
 public:
 	CrosswordPuzzle()
 	: std::vector<Crossword>() {
 	}
+#ifdef CROSSWORD_PROFILE
+	// Copies inside the body, so that the copy itself is timed.
+	CrosswordPuzzle(const CrosswordPuzzle& puzzle)
+	: std::vector<Crossword>() {
+		PROFILE_SCOPE("CrosswordPuzzle copy");
+		assign(puzzle.begin(), puzzle.end());
+	}
+#else
 	CrosswordPuzzle(const CrosswordPuzzle& puzzle)
 	: std::vector<Crossword>(puzzle) {
 	}
+#endif
+	CrosswordPuzzle(CrosswordPuzzle&&) = default;
+	CrosswordPuzzle& operator=(const CrosswordPuzzle&) = default;
+	CrosswordPuzzle& operator=(CrosswordPuzzle&&) = default;
 	CrosswordPuzzle(std::initializer_list<Crossword> il)
 	: std::vector<Crossword>(il) {
 	}
@@ -139,9 +300,9 @@ public:
 		}
 		return yEnd;
 	}
-	std::vector<std::pair<char, const Crossword*>> characters(int x,
-			int y) const {
-		std::vector<std::pair<char, const Crossword*>> founds;
+	CellCharacters characters(int x, int y) const {
+		PROFILE_SCOPE("characters");
+		CellCharacters founds;
 		for (size_t i=0; i<size(); i++) {
 			const Crossword& word = operator[](i);
 			char c = word.character(x, y);
@@ -153,38 +314,28 @@ public:
 	}
 
 	bool valid() const {
-		using CharactersInWord = std::vector<std::pair<char, const Crossword*>>;
-
-	    struct HorizontalCharacters {
-	    	int lineIndex;
-	    	int rowIndex;
-	    	CharactersInWord operator()(const CrosswordPuzzle& puzzle) const {
-	    		return puzzle.characters(lineIndex, rowIndex);
-	    	}
-	    };
-	    struct VerticalCharacters {
-	    	int lineIndex;
-	    	int rowIndex;
-	    	CharactersInWord operator()(const CrosswordPuzzle& puzzle) const {
-	    		return puzzle.characters(rowIndex, lineIndex);
-	    	}
-	    };
-
-	    if (validImpl<HorizontalCharacters>(xStart(), xEnd(), yStart(), yEnd())) {
-		    if (validImpl<VerticalCharacters>(yStart(), yEnd(), xStart(), xEnd())) {
+		PROFILE_SCOPE("valid");
+		auto horizontalCharacters = [this](int rowIndex, int lineIndex) {
+			return characters(rowIndex, lineIndex);
+		};
+		auto verticalCharacters = [this](int rowIndex, int lineIndex) {
+			return characters(lineIndex, rowIndex);
+		};
+
+	    if (validImpl(xStart(), xEnd(), yStart(), yEnd(), horizontalCharacters)) {
+		    if (validImpl(yStart(), yEnd(), xStart(), xEnd(), verticalCharacters)) {
 	            return true;
 	        }
 	    }
 	    return false;
 	}
 	size_t crosses() const {
-		using CharacterInWord = std::pair<char, const Crossword*>;
-	    using CharactersInWord = std::vector<CharacterInWord>;
+		PROFILE_SCOPE("crosses");
 	    size_t result = 0;
 
 		for (int y=yStart(); y<yEnd(); y++) {
 			for (int x=xStart(); x<xEnd(); x++) {
-				CharactersInWord csiw = characters(x, y);
+				CellCharacters csiw = characters(x, y);
 				if (csiw.size() > 1) {
 					result++;
 				}
@@ -193,43 +344,59 @@ public:
 		return result;
 	}
 	std::string toString() const {
-		using CharacterInWord = std::pair<char, const Crossword*>;
-	    using CharactersInWord = std::vector<CharacterInWord>;
-	    const size_t w = xEnd() - xStart();
-	    const size_t h = yEnd() - yStart();
-	    std::string result((w + 1) * h, '\n');
-	    size_t i = 0;
-
-		for (int y=yStart(); y<yEnd(); y++) {
-			for (int x=xStart(); x<xEnd(); x++) {
-				CharactersInWord csiw = characters(x, y);
-				char c = ' ';
-				for (const CharacterInWord& ciw : csiw) {
-					if (c == ' ') {
-					    c = ciw.first;
-					} else if (c != ciw.first) {
-						c = '*';
-					}
+		std::string result;
+		render(result);
+		return result;
+	}
+	// Renders the puzzle into buffer, reusing its capacity. The cells are
+	// filled word by word, so every letter is visited only once. Cells with
+	// conflicting letters are shown as '*'.
+	void render(std::string& buffer) const {
+		PROFILE_SCOPE("render");
+		if (empty()) {
+			buffer.clear();
+			return;
+		}
+		const int xPuzzleStart = xStart();
+		const int yPuzzleStart = yStart();
+	    const size_t w = xEnd() - xPuzzleStart;
+	    const size_t h = yEnd() - yPuzzleStart;
+	    buffer.assign((w + 1) * h, ' ');
+	    for (size_t y=0; y<h; y++) {
+	    	buffer[y * (w + 1) + w] = '\n';
+	    }
+		for (const Crossword& word : *this) {
+			size_t i = (word.yStart() - yPuzzleStart) * (w + 1) +
+					(word.xStart() - xPuzzleStart);
+			const size_t step =
+					word.direction() == Crossword::Direction::HORIZONTAL ?
+							1 : w + 1;
+			for (size_t j=0; j<word.length(); j++) {
+				char& c = buffer[i];
+				if (c == ' ') {
+					c = word[j];
+				} else if (c != word[j]) {
+					c = '*';
 				}
-				result[i] = c;
-				i++;
+				i += step;
 			}
-			i++;
 		}
-		return result;
 	}
 
 protected:
+	friend class BoundedGrid;
+
 	template<class CHARACTERS>
-	bool validImpl(int rowStart, int rowEnd, int lineStart, int lineEnd) const {
-		using CharactersInWord = std::vector<std::pair<char, const Crossword*>>;
+	static bool validImpl(int rowStart, int rowEnd, int lineStart, int lineEnd,
+			const CHARACTERS& characters) {
+		PROFILE_SCOPE("validImpl");
 		const Crossword* owner = nullptr;
 		const Crossword* partner = nullptr;
 		bool ownerPartnerClarified = false;
 
 		for (int lineIndex=lineStart; lineIndex < lineEnd; lineIndex++) {
 			for (int rowIndex=rowStart; rowIndex < rowEnd; rowIndex++) {
-				CharactersInWord ciw = CHARACTERS{rowIndex, lineIndex}(*this);
+				const auto& ciw = characters(rowIndex, lineIndex);
 				if (ciw.size() > 2) {
 					return false;
 				}
@@ -302,6 +469,125 @@ CrosswordPuzzle normalizedPuzzle (const CrosswordPuzzle& puzzle) {
 	return result;
 }
 
+class UnboundedGrid {
+public:
+	bool fits(const CrosswordPuzzle& puzzle) const {
+		return true;
+	}
+	bool transposable() const {
+		return true;
+	}
+	bool valid(const CrosswordPuzzle& puzzle) {
+		return puzzle.valid();
+	}
+};
+
+// Restricts puzzles to a maximum width and height. The cells are kept in one
+// flat array of maxWidth * maxHeight entries that is allocated only once and
+// filled word by word, instead of asking every word for every cell.
+class BoundedGrid {
+public:
+	BoundedGrid(int maxWidth, int maxHeight)
+	: _maxWidth(maxWidth), _maxHeight(maxHeight),
+	  _cells(static_cast<size_t>(maxWidth) * static_cast<size_t>(maxHeight)) {
+	}
+	bool fits(const CrosswordPuzzle& puzzle) const {
+		if (puzzle.empty()) {
+			return true;
+		}
+		return puzzle.xEnd() - puzzle.xStart() <= _maxWidth &&
+				puzzle.yEnd() - puzzle.yStart() <= _maxHeight;
+	}
+	bool transposable() const {
+		return _maxWidth == _maxHeight;
+	}
+	bool valid(const CrosswordPuzzle& puzzle) {
+		PROFILE_SCOPE("BoundedGrid::valid");
+		if (puzzle.empty()) {
+			return true;
+		}
+		const int xStart = puzzle.xStart();
+		const int yStart = puzzle.yStart();
+		const int w = puzzle.xEnd() - xStart;
+		const int h = puzzle.yEnd() - yStart;
+		if (w > _maxWidth || h > _maxHeight) {
+			return false;
+		}
+		for (int i=0; i<w*h; i++) {
+			_cells[i].clear();
+		}
+		for (const Crossword& word : puzzle) {
+			int x = word.xStart() - xStart;
+			int y = word.yStart() - yStart;
+			const bool horizontal =
+					word.direction() == Crossword::Direction::HORIZONTAL;
+			for (size_t i=0; i<word.length(); i++) {
+				_cells[y * w + x].push_back({word[i], &word});
+				if (horizontal) {
+					x++;
+				} else {
+					y++;
+				}
+			}
+		}
+		auto horizontalCharacters = [this, xStart, yStart, w](int rowIndex,
+				int lineIndex) -> const CellCharacters& {
+			return _cells[(lineIndex - yStart) * w + rowIndex - xStart];
+		};
+		auto verticalCharacters = [this, xStart, yStart, w](int rowIndex,
+				int lineIndex) -> const CellCharacters& {
+			return _cells[(rowIndex - yStart) * w + lineIndex - xStart];
+		};
+		return CrosswordPuzzle::validImpl(xStart, xStart + w, yStart,
+				yStart + h, horizontalCharacters) &&
+				CrosswordPuzzle::validImpl(yStart, yStart + h, xStart,
+						xStart + w, verticalCharacters);
+	}
+private:
+	int _maxWidth;
+	int _maxHeight;
+	std::vector<CellCharacters> _cells;
+};
+
+// Writes all puzzles of [begin, end) to out, each followed by an empty line.
+// One buffer is reused for rendering all of them.
+template<class ITERATOR>
+void writePuzzles(ITERATOR begin, ITERATOR end, std::ostream& out) {
+	std::string buffer;
+	for (ITERATOR it=begin; it!=end; ++it) {
+		it->render(buffer);
+		out.write(buffer.data(), buffer.size());
+		out.put('\n');
+	}
+}
+
+// Word lists and puzzles shared by the tests, the profiling workloads and
+// main().
+const std::vector<std::string> FIVE_WORDS = {"MAIWANDERUNG", "NEUN", "SONNE",
+		"RADWEG", "BAZAR"};
+const std::vector<std::string> NINE_WORDS = {"DEHNEN", "NIKOLAUS",
+		"NEUREUTHER", "SOELDEN", "RUNDLAUF", "DREI", "HOCKE", "BUEGELEISEN",
+		"FIS"};
+const std::vector<std::string> TWENTY_WORDS = {"DEHNEN", "NIKOLAUS",
+		"NEUREUTHER", "SOELDEN", "RUNDLAUF", "DREI", "HOCKE", "BUEGELEISEN",
+		"FIS", "HUENDLE", "STELLER", "MAIWANDERUNG", "MARKUS", "ELENA", "PETRA",
+		"XAVER", "XELSBOCK", "SYSTEM", "ROLLADEN", "BUCH"};
+const CrosswordPuzzle VALID_PUZZLE = {
+		{"MAIWANDERUNG", 0, 4, Crossword::Direction::HORIZONTAL},
+		{"NEUN", 10, 4, Crossword::Direction::VERTICAL},
+		{"SONNE", 5, 2, Crossword::Direction::VERTICAL},
+		{"RADWEG", 1, 6, Crossword::Direction::HORIZONTAL},
+		{"BAZAR", 8, 0, Crossword::Direction::VERTICAL},
+};
+// Like VALID_PUZZLE, but NEUN runs along SONNE.
+const CrosswordPuzzle INVALID_PUZZLE = {
+		{"MAIWANDERUNG", 0, 4, Crossword::Direction::HORIZONTAL},
+		{"NEUN", 5, 5, Crossword::Direction::VERTICAL},
+		{"SONNE", 5, 2, Crossword::Direction::VERTICAL},
+		{"RADWEG", 1, 6, Crossword::Direction::HORIZONTAL},
+		{"BAZAR", 8, 0, Crossword::Direction::VERTICAL},
+};
+
 class TestFailed : public std::exception {
 public:
 	TestFailed(const std::string& message)
@@ -321,14 +607,7 @@ void assertTrue(const std::string& checkDescription, bool expression) {
 }
 
 void test_toString() {
-	using Direction = Crossword::Direction;
-	CrosswordPuzzle crossword = {
-			{"MAIWANDERUNG", 0, 4, Direction::HORIZONTAL},
-			{"NEUN", 10, 4, Direction::VERTICAL},
-			{"SONNE", 5, 2, Direction::VERTICAL},
-			{"RADWEG", 1, 6, Direction::HORIZONTAL},
-			{"BAZAR", 8, 0, Direction::VERTICAL},
-	};
+	const CrosswordPuzzle& crossword = VALID_PUZZLE;
 	std::string expectedString =
 			"        B   \n"
 			"        A   \n"
@@ -342,22 +621,38 @@ void test_toString() {
 			expectedString == crossword.toString());
 }
 
-void test_valid() {
+void test_render() {
 	using Direction = Crossword::Direction;
-	CrosswordPuzzle puzzle1 = {
+	std::vector<CrosswordPuzzle> puzzles = {
+		{
 			{"MAIWANDERUNG", 0, 4, Direction::HORIZONTAL},
 			{"NEUN", 10, 4, Direction::VERTICAL},
 			{"SONNE", 5, 2, Direction::VERTICAL},
-			{"RADWEG", 1, 6, Direction::HORIZONTAL},
-			{"BAZAR", 8, 0, Direction::VERTICAL},
-	};
-	CrosswordPuzzle puzzle2 = {
-			{"MAIWANDERUNG", 0, 4, Direction::HORIZONTAL},
-			{"NEUN", 5, 5, Direction::VERTICAL},
-			{"SONNE", 5, 2, Direction::VERTICAL},
-			{"RADWEG", 1, 6, Direction::HORIZONTAL},
-			{"BAZAR", 8, 0, Direction::VERTICAL},
+		},
+		{
+			{"NEUN", 0, 0, Direction::HORIZONTAL},
+			{"RADWEG", 1, 0, Direction::VERTICAL},
+		},
+		{}
 	};
+	std::string buffer;
+	puzzles[0].render(buffer);
+	assertTrue("render() works as expected", buffer == puzzles[0].toString());
+	puzzles[1].render(buffer);
+	assertTrue("render() reuses buffer",
+			buffer == "N*UN\n A  \n D  \n W  \n E  \n G  \n");
+	puzzles[2].render(buffer);
+	assertTrue("render() clears buffer for empty puzzle", buffer.empty());
+	std::ostringstream out;
+	writePuzzles(puzzles.begin(), puzzles.end(), out);
+	assertTrue("writePuzzles() writes all puzzles", out.str() ==
+			puzzles[0].toString() + '\n' + puzzles[1].toString() + "\n\n");
+}
+
+void test_valid() {
+	using Direction = Crossword::Direction;
+	const CrosswordPuzzle& puzzle1 = VALID_PUZZLE;
+	const CrosswordPuzzle& puzzle2 = INVALID_PUZZLE;
 	CrosswordPuzzle puzzle3 = {
 			{"MAIWANDERUNG", 0, 4, Direction::HORIZONTAL},
 			{"NEUN", 5, 5, Direction::HORIZONTAL},
@@ -396,10 +691,10 @@ void test_valid() {
 
 template<typename T>
 bool increaseByOne (std::vector<T>& v,
-		size_t maxElementValue) {
+		typename std::vector<T>::value_type maxElementValue) {
 	bool carryFlag = false;
 
-	for (size_t& value : v) {
+	for (T& value : v) {
 		if (carryFlag) {
 			if (value != maxElementValue) {
 				value = value + 1;
@@ -422,7 +717,7 @@ bool increaseByOne (std::vector<T>& v,
 template <class CrosswordProgress>
 std::set<CrosswordPuzzle> findCrosswordPuzzlesByBruteForce(
 		const std::vector<std::string>& words,
-		size_t minCrosses, size_t maxMatches) {
+		size_t minCrosses, size_t maxMatches, CrosswordProgress& cp) {
 	std::set<CrosswordPuzzle> result;
 	std::vector<std::string>::const_iterator itMaxString =
 			std::max_element(words.begin(), words.end(),
@@ -431,13 +726,15 @@ std::set<CrosswordPuzzle> findCrosswordPuzzlesByBruteForce(
 	const size_t maxLength = itMaxString->length();
 	std::vector<int> yValues (words.size(), 0);
 	size_t n = 0;
-	CrosswordProgress cp;
 
 	do {
 		std::vector<int> xValues (words.size(), 0);
 		do {
 			std::vector<int> directions (words.size(), 0);
 			do {
+				if (cp.cancelled()) {
+					return result;
+				}
 				CrosswordPuzzle puzzle;
 				for (size_t i=0; i<words.size(); i++) {
 					using D = Crossword::Direction;
@@ -449,7 +746,10 @@ std::set<CrosswordPuzzle> findCrosswordPuzzlesByBruteForce(
 					size_t c = puzzle.crosses();
 					if (c >= minCrosses) {
 						cp.foundSolution(puzzle, c, n);
-						result.insert(puzzle);
+						{
+							PROFILE_SCOPE("std::set insert");
+							result.insert(puzzle);
+						}
 						if (result.size() >= maxMatches) {
 							return result;
 						}
@@ -463,12 +763,148 @@ std::set<CrosswordPuzzle> findCrosswordPuzzlesByBruteForce(
 	return result;
 }
 
+template <class CrosswordProgress>
+std::set<CrosswordPuzzle> findCrosswordPuzzlesByBruteForce(
+		const std::vector<std::string>& words,
+		size_t minCrosses, size_t maxMatches) {
+	CrosswordProgress cp;
+	return findCrosswordPuzzlesByBruteForce(words, minCrosses, maxMatches, cp);
+}
+
+// Mixed radix counter, digit 0 is the least significant one. Unlike
+// increaseByOne() it can be started at any linear index.
+class Odometer {
+public:
+	Odometer(const std::vector<size_t>& radices, size_t index)
+	: _radices(radices), _digits(radices.size(), 0) {
+		for (size_t i=0; i<_radices.size(); i++) {
+			_digits[i] = index % _radices[i];
+			index /= _radices[i];
+		}
+	}
+	// Number of all digit combinations. Throws if it exceeds size_t.
+	static size_t combinations(const std::vector<size_t>& radices) {
+		size_t result = 1;
+		for (size_t radix : radices) {
+			if (result > std::numeric_limits<size_t>::max() / radix) {
+				throw std::overflow_error("Too many combinations");
+			}
+			result *= radix;
+		}
+		return result;
+	}
+	bool increaseByOne() {
+		for (size_t i=0; i<_digits.size(); i++) {
+			if (++_digits[i] < _radices[i]) {
+				return true;
+			}
+			_digits[i] = 0;
+		}
+		return false;
+	}
+	size_t operator[](size_t i) const {
+		return _digits[i];
+	}
+private:
+	std::vector<size_t> _radices;
+	std::vector<size_t> _digits;
+};
+
+// Brute force over all directions and positions, split into chunks of the
+// linear index of all combinations. One worker per progress tracer takes the
+// next free chunk and starts its odometer directly at the chunk begin. The
+// first word is fixed at the origin and the other words are placed relative
+// to it, so that no two translated copies of a layout are checked.
+template <class CrosswordProgress>
+std::set<CrosswordPuzzle> findCrosswordPuzzlesByParallelBruteForce(
+		const std::vector<std::string>& words,
+		size_t minCrosses, size_t maxMatches,
+		std::vector<CrosswordProgress>& progressTracers) {
+	static const size_t CHUNK_SIZE = 4096;
+	std::set<CrosswordPuzzle> result;
+	if (words.empty()) {
+		return result;
+	}
+	std::vector<std::string>::const_iterator itMaxString =
+			std::max_element(words.begin(), words.end(),
+			[](const std::string& a, const std::string& b){
+				return a.length() < b.length();});
+	const int maxLength = static_cast<int>(itMaxString->length());
+	const size_t n = words.size();
+	// Digits: directions of all words, then x and y offsets of all words
+	// but the first in the range [-maxLength, maxLength].
+	std::vector<size_t> radices(n, 2);
+	radices.insert(radices.end(), 2 * (n - 1), 2 * maxLength + 1);
+	const size_t numberOfCombinations = Odometer::combinations(radices);
+	std::atomic<size_t> nextChunk(0);
+	std::atomic<size_t> numberOfMatches(0);
+	std::vector<std::set<CrosswordPuzzle>> found(progressTracers.size());
+	std::vector<std::thread> workers;
+
+	for (size_t t=0; t<progressTracers.size(); t++) {
+		workers.emplace_back([&, t]() {
+			CrosswordProgress& cp = progressTracers[t];
+			while (numberOfMatches.load(std::memory_order_relaxed) < maxMatches
+					&& !cp.cancelled()) {
+				const size_t begin = nextChunk.fetch_add(1) * CHUNK_SIZE;
+				if (begin >= numberOfCombinations) {
+					break;
+				}
+				const size_t end = std::min(begin + CHUNK_SIZE,
+						numberOfCombinations);
+				Odometer odometer(radices, begin);
+				for (size_t i=begin; i<end; i++) {
+					using D = Crossword::Direction;
+					CrosswordPuzzle puzzle;
+					for (size_t w=0; w<n; w++) {
+						const int x = w == 0 ? 0 : static_cast<int>(
+								odometer[n + w - 1]) - maxLength;
+						const int y = w == 0 ? 0 : static_cast<int>(
+								odometer[2 * n + w - 2]) - maxLength;
+						puzzle.emplace_back(words[w].c_str(), x, y,
+								odometer[w] == 0 ? D::HORIZONTAL : D::VERTICAL);
+					}
+					if (puzzle.valid()) {
+						size_t c = puzzle.crosses();
+						if (c >= minCrosses) {
+							cp.foundSolution(puzzle, c, i);
+							{
+								PROFILE_SCOPE("std::set insert");
+								found[t].insert(puzzle);
+							}
+							if (numberOfMatches.fetch_add(1) + 1 >= maxMatches) {
+								break;
+							}
+						}
+					}
+					cp.nextIteration(i);
+					odometer.increaseByOne();
+				}
+			}
+		});
+	}
+	for (std::thread& worker : workers) {
+		worker.join();
+	}
+	for (const std::set<CrosswordPuzzle>& f : found) {
+		for (const CrosswordPuzzle& puzzle : f) {
+			if (result.size() >= maxMatches) {
+				return result;
+			}
+			{
+				PROFILE_SCOPE("std::set insert");
+				result.insert(puzzle);
+			}
+		}
+	}
+	return result;
+}
+
 template <class PUSH_BACK_TO_PUZZLE, class PROCESS_NEXT_PUZZLE>
 bool processNextCrosswordPuzzles(const CrosswordPuzzle& puzzle,
 		int x, int y, const WordWithDirection& wwd,
 		PROCESS_NEXT_PUZZLE& pnpFunctor) {
-	using CharactersInWord = std::vector<std::pair<char, const Crossword*>>;
-	CharactersInWord ciw = puzzle.characters(x, y);
+	CellCharacters ciw = puzzle.characters(x, y);
 	char currentChar = ciw[0].first;
 	if (ciw.size() == 1) {
 		PUSH_BACK_TO_PUZZLE pbtp;
@@ -576,12 +1012,10 @@ size_t power(size_t x, size_t p) {
 template <class CrosswordProgress>
 std::set<CrosswordPuzzle> findCrosswordPuzzlesBySica1(
 		const std::vector<std::string>& words,
-		size_t minCrosses, size_t maxMatches) {
+		size_t minCrosses, size_t maxMatches, CrosswordProgress& cp) {
 	std::set<CrosswordPuzzle> found;
 	size_t n = 0;
 	std::vector<std::string> permutedWords = words;
-	CrosswordProgress cp(factorial(words.size()) *
-			(power(2, words.size() / 2)));
 	// Sort words to get all permutations.
 	std::sort(permutedWords.begin(), permutedWords.end());
 
@@ -591,6 +1025,9 @@ std::set<CrosswordPuzzle> findCrosswordPuzzlesBySica1(
 			directions[i] = i%2;
 		}
 		do {
+			if (cp.cancelled()) {
+				return found;
+			}
 			using D = Crossword::Direction;
 			std::vector<WordWithDirection> wordsWithDirection;
 			for (size_t i=0; i<permutedWords.size(); i++) {
@@ -608,7 +1045,10 @@ std::set<CrosswordPuzzle> findCrosswordPuzzlesBySica1(
 					if (found.find(np) != found.end()) {
 						continue;
 					}
-					found.insert(np);
+					{
+						PROFILE_SCOPE("std::set insert");
+						found.insert(np);
+					}
 					cp.foundSolution(foundPuzzle, c, n);
 					if (found.size() >= maxMatches) {
 						return found;
@@ -622,6 +1062,15 @@ std::set<CrosswordPuzzle> findCrosswordPuzzlesBySica1(
 	return found;
 }
 
+template <class CrosswordProgress>
+std::set<CrosswordPuzzle> findCrosswordPuzzlesBySica1(
+		const std::vector<std::string>& words,
+		size_t minCrosses, size_t maxMatches) {
+	CrosswordProgress cp(factorial(words.size()) *
+			(power(2, words.size() / 2)));
+	return findCrosswordPuzzlesBySica1(words, minCrosses, maxMatches, cp);
+}
+
 class EmplaceStringVertical {
 public:
 	void operator()(CrosswordPuzzle& puzzle, const std::string& word,
@@ -640,12 +1089,12 @@ public:
 	}
 };
 
-template <class EMPLACE_STRING_TO_PUZZLE, class PROGRESS_TRACER>
+template <class EMPLACE_STRING_TO_PUZZLE, class GRID, class PROGRESS_TRACER>
 CrosswordPuzzle findAnyPuzzle(const CrosswordPuzzle& puzzle,
-		int x, int y, const std::string& word, PROGRESS_TRACER& pt) {
-	using CharactersInWord = std::vector<std::pair<char, const Crossword*>>;
+		int x, int y, const std::string& word, GRID& grid,
+		PROGRESS_TRACER& pt) {
 	CrosswordPuzzle result;
-	CharactersInWord ciw = puzzle.characters(x, y);
+	CellCharacters ciw = puzzle.characters(x, y);
 	char currentChar = ciw[0].first;
 	if (ciw.size() == 1) {
 		EMPLACE_STRING_TO_PUZZLE estp;
@@ -653,8 +1102,11 @@ CrosswordPuzzle findAnyPuzzle(const CrosswordPuzzle& puzzle,
 			if (currentChar == word[i]) {
 				CrosswordPuzzle puzzleExt = puzzle;
 				estp(puzzleExt, word, x, y, i);
+				if (!grid.fits(puzzleExt)) {
+					continue;
+				}
 				pt.validCheck(puzzle, puzzleExt, word);
-				if (puzzleExt.valid()) {
+				if (grid.valid(puzzleExt)) {
 					result = puzzleExt;
 					break;
 				}
@@ -664,18 +1116,19 @@ CrosswordPuzzle findAnyPuzzle(const CrosswordPuzzle& puzzle,
 	return result;
 }
 
-template<class EMPLACE_STRING_TO_PUZZLE, class PROGRESS_TRACER>
+template<class EMPLACE_STRING_TO_PUZZLE, class GRID, class PROGRESS_TRACER>
 std::vector<CrosswordPuzzle> findPuzzles(
 		const CrosswordPuzzle& puzzle, const std::string& word,
 		int x, int y, const std::vector<std::string>& remainingWords,
-		size_t minCrosses, size_t minPuzzles, PROGRESS_TRACER& pt) {
+		size_t minCrosses, size_t minPuzzles, GRID& grid,
+		PROGRESS_TRACER& pt) {
 	std::vector<CrosswordPuzzle> result;
 	CrosswordPuzzle puzzleExt = findAnyPuzzle<EMPLACE_STRING_TO_PUZZLE>(puzzle,
-			x, y, word, pt);
+			x, y, word, grid, pt);
 	if (puzzleExt.size() > 0) {
 		std::vector<CrosswordPuzzle> found = findPuzzles(
 				puzzleExt, remainingWords, minCrosses,
-				minPuzzles, pt);
+				minPuzzles, grid, pt);
 		std::copy_if (found.begin(), found.end(),
 				std::back_inserter(result),
 				[minCrosses](const CrosswordPuzzle& p){
@@ -685,10 +1138,10 @@ std::vector<CrosswordPuzzle> findPuzzles(
 	return result;
 }
 
-template<class PROGRESS_TRACER>
+template<class GRID, class PROGRESS_TRACER>
 std::vector<CrosswordPuzzle> findPuzzles(const CrosswordPuzzle& puzzle,
 		const std::vector<std::string>& words, size_t minCrosses,
-		size_t minPuzzles, PROGRESS_TRACER& pt) {
+		size_t minPuzzles, GRID& grid, PROGRESS_TRACER& pt) {
 	using D = WordWithDirection::Direction;
 	std::vector<CrosswordPuzzle> result;
 
@@ -696,7 +1149,7 @@ std::vector<CrosswordPuzzle> findPuzzles(const CrosswordPuzzle& puzzle,
 		result.push_back(puzzle);
 		return result;
 	}
-	if (minPuzzles == 0) {
+	if (minPuzzles == 0 || pt.cancelled()) {
 		return result;
 	}
 	for (const std::string& word : words) {
@@ -711,10 +1164,10 @@ std::vector<CrosswordPuzzle> findPuzzles(const CrosswordPuzzle& puzzle,
 					std::vector<CrosswordPuzzle> found =
 							findPuzzles<EmplaceStringVertical>(puzzle, word,
 									x, y, remainingWords,
-									minCrosses, minPuzzles, pt);
+									minCrosses, minPuzzles, grid, pt);
 					std::copy(found.begin(), found.end(),
 							std::back_inserter(result));
-					if (result.size() >= minPuzzles) {
+					if (result.size() >= minPuzzles || pt.cancelled()) {
 						return result;
 					}
 				}
@@ -724,10 +1177,10 @@ std::vector<CrosswordPuzzle> findPuzzles(const CrosswordPuzzle& puzzle,
 					std::vector<CrosswordPuzzle> found =
 							findPuzzles<EmplaceStringHorizontal>(puzzle, word,
 									x, y, remainingWords,
-									minCrosses, minPuzzles, pt);
+									minCrosses, minPuzzles, grid, pt);
 					std::copy(found.begin(), found.end(),
 							std::back_inserter(result));
-					if (result.size() >= minPuzzles) {
+					if (result.size() >= minPuzzles || pt.cancelled()) {
 						return result;
 					}
 				}
@@ -752,107 +1205,1325 @@ public:
 	size_t numberOfValidChecks() const {
 		return _numberOfValidChecks;
 	}
+	bool cancelled() const {
+		return false;
+	}
 private:
 	size_t _numberOfValidChecks;
 };
 
-template<class PROGRESS_TRACER>
-std::vector<CrosswordPuzzle> findPuzzles(const std::vector<std::string>& words,
-		size_t minCrosses, size_t minPuzzles, PROGRESS_TRACER& progressTracer) {
-	std::vector<CrosswordPuzzle> puzzles;
-	for (const std::string& word : words) {
+struct SeedTask {
+	CrosswordPuzzle puzzle;
+	std::vector<std::string> remainingWords;
+};
+
+// One start puzzle per distinct word. Vertical starts only give the
+// transposed puzzles of the horizontal ones, so they are only needed if the
+// grid itself is not transposable.
+template<class GRID>
+std::vector<SeedTask> seedTasks(const std::vector<std::string>& words,
+		const GRID& grid) {
+	using D = WordWithDirection::Direction;
+	std::vector<SeedTask> result;
+	std::set<std::string> seedWords;
+	for (size_t i=0; i<words.size(); i++) {
+		if (!seedWords.insert(words[i]).second) {
+			continue;
+		}
 		std::vector<std::string> remainingWords(words);
-		auto itWord = std::find(remainingWords.begin(), remainingWords.end(),
-				word);
-		if (itWord != remainingWords.end()) {
-			remainingWords.erase(itWord);
-		}
-		CrosswordPuzzle puzzleStartHorizontal;
-		puzzleStartHorizontal.emplace_back(word.c_str(), 0, 0,
-				WordWithDirection::Direction::HORIZONTAL);
-		std::vector<CrosswordPuzzle> foundHorizontal = findPuzzles(
-				puzzleStartHorizontal,remainingWords, minCrosses,
-				minPuzzles - puzzles.size(), progressTracer);
-		puzzles.insert(puzzles.begin(),
-				foundHorizontal.begin(), foundHorizontal.end());
-		if (puzzles.size() >= minPuzzles) {
-			break;
+		remainingWords.erase(remainingWords.begin() + i);
+		for (D direction : {D::HORIZONTAL, D::VERTICAL}) {
+			if (direction == D::VERTICAL && grid.transposable()) {
+				break;
+			}
+			SeedTask task{CrosswordPuzzle(), remainingWords};
+			task.puzzle.emplace_back(words[i].c_str(), 0, 0, direction);
+			if (grid.fits(task.puzzle)) {
+				result.push_back(task);
+			}
 		}
-		CrosswordPuzzle puzzleStartVertical;
-		puzzleStartHorizontal.emplace_back(word.c_str(), 0, 0,
-				WordWithDirection::Direction::VERTICAL);
-		std::vector<CrosswordPuzzle> foundVertical = findPuzzles(
-				puzzleStartVertical, remainingWords, minCrosses,
-				minPuzzles - puzzles.size(), progressTracer);
-		puzzles.insert(puzzles.begin(),
-				foundVertical.begin(), foundVertical.end());
+	}
+	return result;
+}
+
+template<class GRID, class PROGRESS_TRACER>
+std::vector<CrosswordPuzzle> findPuzzles(const std::vector<std::string>& words,
+		size_t minCrosses, size_t minPuzzles, GRID grid,
+		PROGRESS_TRACER& progressTracer) {
+	std::vector<CrosswordPuzzle> puzzles;
+	for (const SeedTask& task : seedTasks(words, grid)) {
 		if (puzzles.size() >= minPuzzles) {
 			break;
 		}
+		std::vector<CrosswordPuzzle> found = findPuzzles(task.puzzle,
+				task.remainingWords, minCrosses, minPuzzles - puzzles.size(),
+				grid, progressTracer);
+		puzzles.insert(puzzles.end(), found.begin(), found.end());
 	}
 	return puzzles;
 }
 
-class CrosswordProgressPrinter {
+// Progress tracer of one seed task. It is also cancelled as soon as all
+// seed tasks together have found enough puzzles.
+template<class PROGRESS_TRACER>
+class SeedTaskTracer {
 public:
-	CrosswordProgressPrinter(size_t numberOfVariants)
-    : _numberOfVariants(numberOfVariants) {
+	SeedTaskTracer(PROGRESS_TRACER& pt, const std::atomic<bool>& done)
+	: _pt(pt), _done(done) {
 	}
-	void foundSolution(const CrosswordPuzzle& puzzle, size_t crosses,
-			size_t iterations) {
-		std::cout << "Found solution (";
-		std::cout << crosses << " crosses, iterations=" << iterations << "):\n";
-		std::cout << "===============\n";
-		std::cout << puzzle.toString() << '\n';
-		std::cout << "===============\n";
+	void validCheck(const CrosswordPuzzle& puzzleOld,
+			const CrosswordPuzzle& puzzleNew, const std::string& word) {
+		_pt.validCheck(puzzleOld, puzzleNew, word);
 	}
-	void nextIteration(size_t n) {
-		if (n % 100 == 0 && n != 0) {
-			std::cout << "Searched " << n << " of " << _numberOfVariants;
-			std::cout << " variants.\n";
-		}
+	bool cancelled() const {
+		return _done.load(std::memory_order_relaxed) || _pt.cancelled();
 	}
 private:
-	size_t _numberOfVariants;
+	PROGRESS_TRACER& _pt;
+	const std::atomic<bool>& _done;
 };
 
-int main() {
-	size_t numberOfFailedTests = 0;
-	try {
-		test_toString();
-	} catch (const TestFailed& e) {
-		std::cerr << e.what() << '\n';
-		numberOfFailedTests++;
+// Like findPuzzles(), but the seed tasks are run by one worker per progress
+// tracer. Every seed task may find up to minPuzzles puzzles on its own. The
+// results are merged in seed order.
+template<class GRID, class PROGRESS_TRACER>
+std::vector<CrosswordPuzzle> findPuzzlesParallel(
+		const std::vector<std::string>& words, size_t minCrosses,
+		size_t minPuzzles, const GRID& grid,
+		std::vector<PROGRESS_TRACER>& progressTracers) {
+	std::vector<CrosswordPuzzle> result;
+	if (minPuzzles == 0) {
+		return result;
 	}
-	try {
-		test_valid();
-	} catch (const TestFailed& e) {
-		std::cerr << e.what() << '\n';
-		numberOfFailedTests++;
+	const std::vector<SeedTask> tasks = seedTasks(words, grid);
+	std::vector<std::vector<CrosswordPuzzle>> found(tasks.size());
+	std::atomic<size_t> nextTask(0);
+	std::atomic<size_t> numberOfPuzzles(0);
+	std::atomic<bool> done(false);
+	std::vector<std::thread> workers;
+
+	for (size_t t=0; t<progressTracers.size(); t++) {
+		workers.emplace_back([&, t]() {
+			GRID workerGrid(grid);
+			SeedTaskTracer<PROGRESS_TRACER> tracer(progressTracers[t], done);
+			while (!tracer.cancelled()) {
+				const size_t i = nextTask.fetch_add(1);
+				if (i >= tasks.size()) {
+					break;
+				}
+				found[i] = findPuzzles(tasks[i].puzzle, tasks[i].remainingWords,
+						minCrosses, minPuzzles, workerGrid, tracer);
+				if (numberOfPuzzles.fetch_add(found[i].size()) +
+						found[i].size() >= minPuzzles) {
+					done = true;
+				}
+			}
+		});
 	}
-	if (numberOfFailedTests > 0) {
-		std::cerr << numberOfFailedTests << " test failed.\n";
-	} else {
-		std::cout << "All tests successful.\n";
+	for (std::thread& worker : workers) {
+		worker.join();
+	}
+	for (const std::vector<CrosswordPuzzle>& f : found) {
+		for (const CrosswordPuzzle& puzzle : f) {
+			if (result.size() >= minPuzzles) {
+				return result;
+			}
+			result.push_back(puzzle);
+		}
+	}
+	return result;
+}
+
+template<class PROGRESS_TRACER>
+std::vector<CrosswordPuzzle> findPuzzles(const std::vector<std::string>& words,
+		size_t minCrosses, size_t minPuzzles, PROGRESS_TRACER& progressTracer) {
+	return findPuzzles(words, minCrosses, minPuzzles, UnboundedGrid(),
+			progressTracer);
+}
+
+void test_boundedGrid() {
+	using Direction = Crossword::Direction;
+	const CrosswordPuzzle& puzzle1 = VALID_PUZZLE;
+	const CrosswordPuzzle& puzzle2 = INVALID_PUZZLE;
+	CrosswordPuzzle puzzle3 = {
+			{"MAIWANDERUNG", 0, 0, Direction::VERTICAL},
+			{"RADWEG", 0, 1, Direction::HORIZONTAL},
+	};
+	BoundedGrid grid(15, 15);
+
+	assertTrue("puzzle1 fits into 12x8", BoundedGrid(12, 8).fits(puzzle1));
+	assertTrue("puzzle1 does not fit into 11x8",
+			!BoundedGrid(11, 8).fits(puzzle1));
+	assertTrue("puzzle1 does not fit into 12x7",
+			!BoundedGrid(12, 7).fits(puzzle1));
+	assertTrue("puzzle1 is valid in grid", grid.valid(puzzle1));
+	assertTrue("puzzle2 is not valid in grid", !grid.valid(puzzle2));
+	assertTrue("puzzle3 is not valid in grid", !grid.valid(puzzle3));
+	assertTrue("puzzle1 is still valid in grid", grid.valid(puzzle1));
+	assertTrue("empty puzzle fits and is valid",
+			grid.fits(CrosswordPuzzle()) && grid.valid(CrosswordPuzzle()));
+
+	const std::vector<std::string>& words = FIVE_WORDS;
+	SimpleProgressTracer progressTracer;
+	BoundedGrid smallGrid(12, 9);
+	std::vector<CrosswordPuzzle> found = findPuzzles(words, 4, 5, smallGrid,
+			progressTracer);
+	assertTrue("findPuzzles finds puzzles in bounded grid", !found.empty());
+	for (const CrosswordPuzzle& puzzle : found) {
+		assertTrue("findPuzzles only returns puzzles that fit the grid",
+				smallGrid.fits(puzzle) && puzzle.size() == words.size() &&
+				puzzle.valid());
+	}
+}
+
+// A cell of a placed word where a word of the other direction can cross it.
+struct Intersection {
+	int x;
+	int y;
+	WordWithDirection::Direction direction;
+};
+
+std::vector<Intersection> intersections(const CrosswordPuzzle& puzzle) {
+	using D = WordWithDirection::Direction;
+	std::vector<Intersection> result;
+	for (const Crossword& cw : puzzle) {
+		if (cw.direction() == D::HORIZONTAL) {
+			for (int x=cw.xStart(); x<cw.xEnd(); x++) {
+				result.push_back({x, cw.yStart(), D::HORIZONTAL});
+			}
+		} else {
+			for (int y=cw.yStart(); y<cw.yEnd(); y++) {
+				result.push_back({cw.xStart(), y, D::VERTICAL});
+			}
+		}
+	}
+	return result;
+}
+
+// Element i (starting at 1) of the Luby sequence 1,1,2,1,1,2,4,1,1,2,...
+size_t luby(size_t i) {
+	size_t k = 1;
+	while ((static_cast<size_t>(1) << k) - 1 < i) {
+		k++;
+	}
+	if ((static_cast<size_t>(1) << k) - 1 == i) {
+		return static_cast<size_t>(1) << (k - 1);
+	}
+	return luby(i - (static_cast<size_t>(1) << (k - 1)) + 1);
+}
+
+// Searches for a single puzzle with shuffled word and intersection order.
+// Each run is cut off after a number of valid checks that follows the Luby
+// sequence, then restarted with a fresh shuffle. The random generator is only
+// seeded once, so the whole search is reproducible for a given seed.
+template<class GRID, class PROGRESS_TRACER>
+class RandomizedPuzzleSearch {
+public:
+	static const size_t LUBY_UNIT = 1000;
+
+	RandomizedPuzzleSearch(size_t seed, size_t minCrosses, const GRID& grid,
+			PROGRESS_TRACER& pt, const std::atomic<bool>& cancelled)
+	: _random(seed), _minCrosses(minCrosses), _grid(grid), _pt(pt),
+	  _cancelled(cancelled),
+	  _budget(0), _budgetExhausted(false) {
+	}
+	std::vector<CrosswordPuzzle> find(const std::vector<std::string>& words) {
+		std::vector<CrosswordPuzzle> result;
+		for (size_t run=1; !_cancelled.load(std::memory_order_relaxed); run++) {
+			_budget = luby(run) * LUBY_UNIT;
+			_budgetExhausted = false;
+			std::vector<SeedTask> tasks = seedTasks(words, _grid);
+			std::shuffle(tasks.begin(), tasks.end(), _random);
+			for (size_t i=0; i<tasks.size() && !aborted(); i++) {
+				CrosswordPuzzle found;
+				if (search(tasks[i].puzzle, tasks[i].remainingWords, found)) {
+					result.push_back(found);
+					return result;
+				}
+			}
+			if (!_budgetExhausted) {
+				// The run was not cut off, so the search space of this engine
+				// is exhausted. findAnyPuzzle only tries the first valid offset
+				// per intersection, so other puzzles may still exist.
+				break;
+			}
+		}
+		return result;
+	}
+	void validCheck(const CrosswordPuzzle& puzzleOld,
+			const CrosswordPuzzle& puzzleNew, const std::string& word) {
+		_pt.validCheck(puzzleOld, puzzleNew, word);
+		if (_budget > 0) {
+			_budget--;
+		} else {
+			_budgetExhausted = true;
+		}
+	}
+private:
+	bool aborted() const {
+		return _budgetExhausted || _cancelled.load(std::memory_order_relaxed) ||
+				_pt.cancelled();
+	}
+	bool search(const CrosswordPuzzle& puzzle,
+			const std::vector<std::string>& words, CrosswordPuzzle& result) {
+		using D = WordWithDirection::Direction;
+		if (words.size() == 0) {
+			if (puzzle.crosses() >= _minCrosses) {
+				result = puzzle;
+				return true;
+			}
+			return false;
+		}
+		std::vector<Intersection> crossings = intersections(puzzle);
+		std::shuffle(crossings.begin(), crossings.end(), _random);
+		std::vector<size_t> wordOrder(words.size());
+		std::iota(wordOrder.begin(), wordOrder.end(), 0);
+		std::shuffle(wordOrder.begin(), wordOrder.end(), _random);
+
+		for (size_t wordIndex : wordOrder) {
+			std::vector<std::string> remainingWords(words);
+			remainingWords.erase(remainingWords.begin() + wordIndex);
+			const std::string& word = words[wordIndex];
+			for (const Intersection& is : crossings) {
+				CrosswordPuzzle puzzleExt = is.direction == D::HORIZONTAL ?
+						findAnyPuzzle<EmplaceStringVertical>(puzzle,
+								is.x, is.y, word, _grid, *this) :
+						findAnyPuzzle<EmplaceStringHorizontal>(puzzle,
+								is.x, is.y, word, _grid, *this);
+				if (aborted()) {
+					return false;
+				}
+				if (puzzleExt.size() > 0 &&
+						search(puzzleExt, remainingWords, result)) {
+					return true;
+				}
+			}
+		}
+		return false;
+	}
+
+	std::mt19937_64 _random;
+	size_t _minCrosses;
+	GRID _grid;
+	PROGRESS_TRACER& _pt;
+	const std::atomic<bool>& _cancelled;
+	size_t _budget;
+	bool _budgetExhausted;
+};
+
+template<class GRID, class PROGRESS_TRACER>
+std::vector<CrosswordPuzzle> findPuzzleRandomized(
+		const std::vector<std::string>& words, size_t minCrosses,
+		size_t seed, const GRID& grid, PROGRESS_TRACER& progressTracer) {
+	std::atomic<bool> cancelled(false);
+	RandomizedPuzzleSearch<GRID, PROGRESS_TRACER> search(seed, minCrosses,
+			grid, progressTracer, cancelled);
+	return search.find(words);
+}
+
+template<class PROGRESS_TRACER>
+std::vector<CrosswordPuzzle> findPuzzleRandomized(
+		const std::vector<std::string>& words, size_t minCrosses,
+		size_t seed, PROGRESS_TRACER& progressTracer) {
+	return findPuzzleRandomized(words, minCrosses, seed, UnboundedGrid(),
+			progressTracer);
+}
+
+// Runs one randomized search per progress tracer, worker i seeded with
+// seed + i. The first worker to finish cancels the others and its seed is
+// stored in winningSeed. Which worker wins depends on timing, but its result
+// can be reproduced with findPuzzleRandomized() and winningSeed. Every
+// worker gets its own copy of the grid.
+template<class GRID, class PROGRESS_TRACER>
+std::vector<CrosswordPuzzle> findPuzzleByPortfolio(
+		const std::vector<std::string>& words, size_t minCrosses,
+		size_t seed, const GRID& grid,
+		std::vector<PROGRESS_TRACER>& progressTracers, size_t& winningSeed) {
+	std::vector<CrosswordPuzzle> result;
+	bool finished = false;
+	std::atomic<bool> cancelled(false);
+	std::mutex resultMutex;
+	std::vector<std::thread> workers;
+	for (size_t i=0; i<progressTracers.size(); i++) {
+		workers.emplace_back([&, i]() {
+			RandomizedPuzzleSearch<GRID, PROGRESS_TRACER> search(seed + i,
+					minCrosses, grid, progressTracers[i], cancelled);
+			std::vector<CrosswordPuzzle> found = search.find(words);
+			std::lock_guard<std::mutex> lock(resultMutex);
+			if (!finished) {
+				finished = true;
+				result = found;
+				winningSeed = seed + i;
+			}
+			// Either found a puzzle or exhausted the search space.
+			cancelled = true;
+		});
+	}
+	for (std::thread& worker : workers) {
+		worker.join();
+	}
+	return result;
+}
+
+template<class PROGRESS_TRACER>
+std::vector<CrosswordPuzzle> findPuzzleByPortfolio(
+		const std::vector<std::string>& words, size_t minCrosses,
+		size_t seed, std::vector<PROGRESS_TRACER>& progressTracers,
+		size_t& winningSeed) {
+	return findPuzzleByPortfolio(words, minCrosses, seed, UnboundedGrid(),
+			progressTracers, winningSeed);
+}
+
+// Counts valid checks like SimpleProgressTracer, but sleeps after each one.
+class DelayedProgressTracer {
+public:
+	explicit DelayedProgressTracer(std::chrono::milliseconds delay)
+	: _delay(delay), _numberOfValidChecks(0) {
+	}
+	void validCheck(const CrosswordPuzzle& puzzleOld,
+			const CrosswordPuzzle& puzzleNew, const std::string& word) {
+		_numberOfValidChecks++;
+		std::this_thread::sleep_for(_delay);
+	}
+	size_t numberOfValidChecks() const {
+		return _numberOfValidChecks;
+	}
+	bool cancelled() const {
+		return false;
+	}
+private:
+	std::chrono::milliseconds _delay;
+	size_t _numberOfValidChecks;
+};
+
+void test_randomized() {
+	const size_t expectedLuby[] = {1, 1, 2, 1, 1, 2, 4, 1};
+	for (size_t i=0; i<8; i++) {
+		assertTrue("luby() returns 1,1,2,1,1,2,4,1",
+				luby(i + 1) == expectedLuby[i]);
+	}
+
+	const std::vector<std::string>& words5 = FIVE_WORDS;
+	SimpleProgressTracer progressTracer;
+	std::vector<CrosswordPuzzle> found = findPuzzleRandomized(words5, 4, 0,
+			progressTracer);
+	assertTrue("findPuzzleRandomized finds one complete valid puzzle",
+			found.size() == 1 && found[0].size() == words5.size() &&
+			found[0].valid() && found[0].crosses() >= 4);
+
+	// Seed 2 needs several Luby runs for the 9-word list.
+	const std::vector<std::string>& words9 = NINE_WORDS;
+	SimpleProgressTracer progressTracer1;
+	SimpleProgressTracer progressTracer2;
+	std::vector<CrosswordPuzzle> found1 = findPuzzleRandomized(words9, 10, 2,
+			progressTracer1);
+	std::vector<CrosswordPuzzle> found2 = findPuzzleRandomized(words9, 10, 2,
+			progressTracer2);
+	assertTrue("findPuzzleRandomized is reproducible for a seed",
+			found1.size() == 1 && found2.size() == 1 &&
+			found1[0].toString() == found2[0].toString() &&
+			progressTracer1.numberOfValidChecks() ==
+					progressTracer2.numberOfValidChecks() &&
+			progressTracer1.numberOfValidChecks() >
+					RandomizedPuzzleSearch<UnboundedGrid,
+							SimpleProgressTracer>::LUBY_UNIT);
+
+	// Worker 1 sleeps after every valid check, so worker 0 wins and has to
+	// stop worker 1 long before it finishes on its own.
+	SimpleProgressTracer aloneTracer;
+	findPuzzleRandomized(words5, 4, 1, aloneTracer);
+	std::vector<DelayedProgressTracer> progressTracers;
+	progressTracers.emplace_back(std::chrono::milliseconds(0));
+	progressTracers.emplace_back(std::chrono::milliseconds(200));
+	size_t winningSeed = 1000;
+	found = findPuzzleByPortfolio(words5, 4, 0, progressTracers, winningSeed);
+	SimpleProgressTracer replayTracer;
+	std::vector<CrosswordPuzzle> replayed = findPuzzleRandomized(words5, 4,
+			winningSeed, replayTracer);
+	assertTrue("findPuzzleByPortfolio reports the seed of the winner",
+			winningSeed == 0 && found.size() == 1 && replayed.size() == 1 &&
+			found[0].toString() == replayed[0].toString());
+	assertTrue("findPuzzleByPortfolio stops the other workers",
+			progressTracers[1].numberOfValidChecks() <
+					aloneTracer.numberOfValidChecks());
+}
+
+// Read-only memory mapping of a whole file.
+class MappedFile {
+public:
+	MappedFile(const std::string& path)
+	: _data(nullptr), _size(0) {
+		int fd = open(path.c_str(), O_RDONLY);
+		if (fd < 0) {
+			throw std::runtime_error("Cannot open " + path);
+		}
+		struct stat st;
+		if (fstat(fd, &st) != 0) {
+			close(fd);
+			throw std::runtime_error("Cannot stat " + path);
+		}
+		_size = static_cast<size_t>(st.st_size);
+		if (_size > 0) {
+			void* data = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+			if (data == MAP_FAILED) {
+				close(fd);
+				throw std::runtime_error("Cannot map " + path);
+			}
+			_data = static_cast<const char*>(data);
+		}
+		close(fd);
+	}
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+	~MappedFile() {
+		if (_data != nullptr) {
+			munmap(const_cast<char*>(_data), _size);
+		}
+	}
+	const char* data() const {
+		return _data;
+	}
+	size_t size() const {
+		return _size;
+	}
+private:
+	const char* _data;
+	size_t _size;
+};
+
+// A large word list with one word per line. The words stay in the loaded
+// buffer and are indexed by (length, position, letter), so that all words
+// with a given letter at a given position are found without a scan.
+class Dictionary {
+public:
+	using WordId = uint32_t;
+	static const size_t MAX_WORD_LENGTH = 255;
+
+	Dictionary(const std::string& path)
+	: _file(new MappedFile(path)) {
+		build(_file->data(), _file->size());
+	}
+	Dictionary(const std::vector<std::string>& words) {
+		for (const std::string& word : words) {
+			_buffer += word;
+			_buffer += '\n';
+		}
+		build(_buffer.data(), _buffer.size());
+	}
+	Dictionary(const Dictionary&) = delete;
+	Dictionary& operator=(const Dictionary&) = delete;
+
+	size_t size() const {
+		return _words.size();
+	}
+	std::string word(WordId id) const {
+		return std::string(_words[id].first, _words[id].second);
+	}
+	size_t length(WordId id) const {
+		return _words[id].second;
+	}
+	// Whether two words have the same text. Lines are not deduplicated, so
+	// different ids can stand for the same word.
+	bool sameText(WordId a, WordId b) const {
+		return _words[a].second == _words[b].second &&
+				std::equal(_words[a].first, _words[a].first + _words[a].second,
+						_words[b].first);
+	}
+	// All words of the given length with the letter at the position.
+	const std::vector<WordId>& words(size_t length, size_t position,
+			char letter) const {
+		static const std::vector<WordId> none;
+		auto it = _index.find(key(length, position, letter));
+		return it != _index.end() ? it->second : none;
+	}
+	// All (length, position) pairs for which words(length, position, letter)
+	// is not empty.
+	const std::vector<std::pair<size_t, size_t>>& positions(
+			char letter) const {
+		return _positions[static_cast<unsigned char>(letter)];
+	}
+private:
+	static uint32_t key(size_t length, size_t position, char letter) {
+		return static_cast<uint32_t>(length) << 16 |
+				static_cast<uint32_t>(position) << 8 |
+				static_cast<unsigned char>(letter);
+	}
+	void build(const char* data, size_t size) {
+		const char* end = data + size;
+		const char* begin = data;
+		while (begin < end) {
+			const char* lineEnd = std::find(begin, end, '\n');
+			size_t length = lineEnd - begin;
+			if (length > 0 && begin[length - 1] == '\r') {
+				length--;
+			}
+			if (length >= 2 && length <= MAX_WORD_LENGTH) {
+				WordId id = static_cast<WordId>(_words.size());
+				_words.emplace_back(begin, length);
+				for (size_t i=0; i<length; i++) {
+					std::vector<WordId>& ids = _index[key(length, i, begin[i])];
+					if (ids.empty()) {
+						_positions[static_cast<unsigned char>(begin[i])]
+								.emplace_back(length, i);
+					}
+					ids.push_back(id);
+				}
+			}
+			begin = lineEnd + 1;
+		}
+	}
+
+	std::unique_ptr<MappedFile> _file;
+	std::string _buffer;
+	std::vector<std::pair<const char*, size_t>> _words;
+	std::unordered_map<uint32_t, std::vector<WordId>> _index;
+	std::vector<std::pair<size_t, size_t>> _positions[256];
+};
+
+// Builds a puzzle of a given number of words chosen from a dictionary. At
+// every open intersection only the dictionary words that have the letter of
+// the intersection somewhere are tried, looked up through the index. The
+// (length, position) pairs are shuffled and every posting list is entered at
+// a random offset, so different seeds give different puzzles.
+//
+// This is a heuristic: only maxCandidates words per (length, position) are
+// tried at an intersection, and each run starts from one random word and is
+// cut off after a number of valid checks that follows the Luby sequence.
+// After maxRuns runs the fill gives up, so an empty result does not mean that
+// no puzzle exists.
+template<class GRID, class PROGRESS_TRACER>
+class DictionaryFill {
+public:
+	static const size_t LUBY_UNIT = 1000;
+
+	DictionaryFill(const Dictionary& dictionary, size_t numberOfWords,
+			size_t minCrosses, size_t seed, const GRID& grid,
+			PROGRESS_TRACER& pt, size_t maxCandidates, size_t maxRuns)
+	: _dictionary(dictionary), _numberOfWords(numberOfWords),
+	  _minCrosses(minCrosses), _random(seed), _grid(grid), _pt(pt),
+	  _maxCandidates(maxCandidates), _maxRuns(maxRuns), _budget(0) {
+	}
+	std::vector<CrosswordPuzzle> find() {
+		std::vector<CrosswordPuzzle> result;
+		if (_dictionary.size() == 0) {
+			return result;
+		}
+		for (size_t run=1; run<=_maxRuns && !_pt.cancelled(); run++) {
+			_budget = luby(run) * LUBY_UNIT;
+			Dictionary::WordId id = static_cast<Dictionary::WordId>(
+					_random() % _dictionary.size());
+			CrosswordPuzzle puzzleStart;
+			puzzleStart.emplace_back(_dictionary.word(id).c_str(), 0, 0,
+					WordWithDirection::Direction::HORIZONTAL);
+			if (!_grid.fits(puzzleStart)) {
+				continue;
+			}
+			_used.assign(1, id);
+			CrosswordPuzzle found;
+			if (search(puzzleStart, found)) {
+				result.push_back(found);
+				break;
+			}
+		}
+		return result;
+	}
+private:
+	bool aborted() const {
+		return _budget == 0 || _pt.cancelled();
+	}
+	bool search(const CrosswordPuzzle& puzzle, CrosswordPuzzle& result) {
+		using D = WordWithDirection::Direction;
+		if (puzzle.size() >= _numberOfWords) {
+			if (puzzle.crosses() >= _minCrosses) {
+				result = puzzle;
+				return true;
+			}
+			return false;
+		}
+		std::vector<Intersection> crossings = intersections(puzzle);
+		std::shuffle(crossings.begin(), crossings.end(), _random);
+
+		for (const Intersection& is : crossings) {
+			if (aborted()) {
+				return false;
+			}
+			CellCharacters ciw = puzzle.characters(is.x, is.y);
+			if (ciw.size() != 1) {
+				continue;
+			}
+			std::vector<std::pair<size_t, size_t>> positions =
+					_dictionary.positions(ciw[0].first);
+			std::shuffle(positions.begin(), positions.end(), _random);
+			for (const std::pair<size_t, size_t>& lp : positions) {
+				const std::vector<Dictionary::WordId>& ids =
+						_dictionary.words(lp.first, lp.second, ciw[0].first);
+				const size_t offset = _random() % ids.size();
+				const size_t n = ids.size() < _maxCandidates ?
+						ids.size() : _maxCandidates;
+				for (size_t k=0; k<n; k++) {
+					Dictionary::WordId id = ids[(offset + k) % ids.size()];
+					if (std::any_of(_used.begin(), _used.end(),
+							[this, id](Dictionary::WordId usedId) {
+								return _dictionary.sameText(id, usedId);
+							})) {
+						continue;
+					}
+					CrosswordPuzzle puzzleExt = puzzle;
+					const std::string word = _dictionary.word(id);
+					if (is.direction == D::HORIZONTAL) {
+						EmplaceStringVertical()(puzzleExt, word,
+								is.x, is.y, lp.second);
+					} else {
+						EmplaceStringHorizontal()(puzzleExt, word,
+								is.x, is.y, lp.second);
+					}
+					if (!_grid.fits(puzzleExt)) {
+						continue;
+					}
+					if (aborted()) {
+						return false;
+					}
+					_pt.validCheck(puzzle, puzzleExt, word);
+					_budget--;
+					if (!_grid.valid(puzzleExt)) {
+						continue;
+					}
+					_used.push_back(id);
+					if (search(puzzleExt, result)) {
+						return true;
+					}
+					_used.pop_back();
+				}
+			}
+		}
+		return false;
+	}
+
+	const Dictionary& _dictionary;
+	size_t _numberOfWords;
+	size_t _minCrosses;
+	std::mt19937_64 _random;
+	GRID _grid;
+	PROGRESS_TRACER& _pt;
+	size_t _maxCandidates;
+	size_t _maxRuns;
+	size_t _budget;
+	std::vector<Dictionary::WordId> _used;
+};
+
+template<class GRID, class PROGRESS_TRACER>
+std::vector<CrosswordPuzzle> fillPuzzleFromDictionary(
+		const Dictionary& dictionary, size_t numberOfWords,
+		size_t minCrosses, size_t seed, const GRID& grid,
+		PROGRESS_TRACER& progressTracer, size_t maxCandidates,
+		size_t maxRuns) {
+	DictionaryFill<GRID, PROGRESS_TRACER> fill(dictionary, numberOfWords,
+			minCrosses, seed, grid, progressTracer, maxCandidates, maxRuns);
+	return fill.find();
+}
+
+void test_dictionary() {
+	Dictionary dictionary({"MAIWANDERUNG", "NEUN", "SONNE", "RADWEG",
+			"BAZAR", "X", "NEUN\r"});
+	assertTrue("dictionary skips one letter words", dictionary.size() == 6);
+	assertTrue("dictionary strips carriage returns",
+			dictionary.word(5) == "NEUN");
+	const std::vector<Dictionary::WordId>& n0 = dictionary.words(4, 0, 'N');
+	assertTrue("dictionary finds words by letter position",
+			n0.size() == 2 && dictionary.word(n0[0]) == "NEUN");
+	assertTrue("dictionary finds no words for unknown letter position",
+			dictionary.words(5, 4, 'Q').empty());
+	assertTrue("dictionary knows letter positions",
+			dictionary.positions('Z').size() == 1 &&
+			dictionary.positions('Z')[0] == std::make_pair<size_t, size_t>(5, 2));
+	assertTrue("dictionary compares words by text",
+			dictionary.sameText(1, 5) && !dictionary.sameText(1, 2));
+	Dictionary duplicates({"NEUN", "NEUN", "NEUN\r"});
+	SimpleProgressTracer progressTracer;
+	assertTrue("dictionary fill does not place the same word twice",
+			fillPuzzleFromDictionary(duplicates, 2, 0, 0, UnboundedGrid(),
+					progressTracer, 4, 10).empty());
+
+	// Every word twice, the second time with a Windows line end.
+	char path[] = "/tmp/crossword_dictionaryXXXXXX";
+	int fd = mkstemp(path);
+	assertTrue("temporary dictionary file can be created", fd >= 0);
+	close(fd);
+	{
+		std::ofstream out(path);
+		for (const std::string& word : TWENTY_WORDS) {
+			out << word << '\n' << word << "\r\n";
+		}
+	}
+	Dictionary fileDictionary(path);
+	std::remove(path);
+	assertTrue("dictionary loads all words from a file",
+			fileDictionary.size() == 2 * TWENTY_WORDS.size() &&
+			fileDictionary.word(1) == TWENTY_WORDS[0]);
+	BoundedGrid grid(15, 15);
+	std::vector<CrosswordPuzzle> found = fillPuzzleFromDictionary(
+			fileDictionary, 8, 7, 0, grid, progressTracer, 4, 100);
+	assertTrue("dictionary fill finds a puzzle", found.size() == 1);
+	const CrosswordPuzzle& puzzle = found[0];
+	std::set<std::string> texts;
+	for (const Crossword& crossword : puzzle) {
+		texts.insert(crossword.text());
+	}
+	assertTrue("dictionary fill places the requested number of words",
+			puzzle.size() == 8 && puzzle.crosses() >= 7);
+	assertTrue("dictionary fill finds a valid puzzle inside the grid",
+			puzzle.valid() && grid.fits(puzzle) && grid.valid(puzzle));
+	assertTrue("dictionary fill does not repeat a word",
+			texts.size() == puzzle.size());
+}
+
+class CrosswordProgressPrinter {
+public:
+	CrosswordProgressPrinter(size_t numberOfVariants)
+    : _numberOfVariants(numberOfVariants) {
+	}
+	void foundSolution(const CrosswordPuzzle& puzzle, size_t crosses,
+			size_t iterations) {
+		std::cout << "Found solution (";
+		std::cout << crosses << " crosses, iterations=" << iterations << "):\n";
+		std::cout << "===============\n";
+		puzzle.render(_buffer);
+		std::cout << _buffer << '\n';
+		std::cout << "===============\n";
+	}
+	void nextIteration(size_t n) {
+		if (n % 100 == 0 && n != 0) {
+			std::cout << "Searched " << n << " of " << _numberOfVariants;
+			std::cout << " variants.\n";
+		}
+	}
+	bool cancelled() const {
+		return false;
+	}
+private:
+	size_t _numberOfVariants;
+	std::string _buffer;
+};
+
+// Progress tracer for callers that only need the number of solutions. It
+// never renders anything, the found puzzles can be written later on demand
+// with writePuzzles().
+class SolutionCounter {
+public:
+	SolutionCounter()
+	: _numberOfSolutions(0) {
+	}
+	SolutionCounter(size_t numberOfVariants)
+	: _numberOfSolutions(0) {
+	}
+	void foundSolution(const CrosswordPuzzle& puzzle, size_t crosses,
+			size_t iterations) {
+		_numberOfSolutions++;
+	}
+	void nextIteration(size_t n) {
+	}
+	bool cancelled() const {
+		return false;
+	}
+	size_t numberOfSolutions() const {
+		return _numberOfSolutions;
+	}
+private:
+	size_t _numberOfSolutions;
+};
+
+void test_solutionCounter() {
+	const std::vector<std::string>& words = FIVE_WORDS;
+	SolutionCounter counter;
+	std::set<CrosswordPuzzle> found = findCrosswordPuzzlesBySica1(words, 4,
+			100000, counter);
+	assertTrue("SolutionCounter counts every solution of Sica1",
+			!found.empty() && counter.numberOfSolutions() == found.size());
+	std::ostringstream out;
+	writePuzzles(found.begin(), found.end(), out);
+	std::string expected;
+	for (const CrosswordPuzzle& puzzle : found) {
+		expected += puzzle.toString() + '\n';
+	}
+	assertTrue("counted solutions can be written later", out.str() == expected);
+}
+
+// Bounded queue between exactly one producer and one consumer thread. Both
+// sides only touch their own index and publish it with release semantics.
+template<class T, size_t SIZE>
+class SingleProducerRing {
+public:
+	static const size_t CAPACITY = SIZE;
+
+	SingleProducerRing()
+	: _head(0), _tail(0) {
+	}
+	// Moves value into the ring. Returns false if the ring is full.
+	bool push(T& value) {
+		const size_t head = _head.load(std::memory_order_relaxed);
+		if (head - _tail.load(std::memory_order_acquire) == CAPACITY) {
+			return false;
+		}
+		_slots[head % CAPACITY] = std::move(value);
+		_head.store(head + 1, std::memory_order_release);
+		return true;
+	}
+	bool pop(T& value) {
+		const size_t tail = _tail.load(std::memory_order_relaxed);
+		if (tail == _head.load(std::memory_order_acquire)) {
+			return false;
+		}
+		value = std::move(_slots[tail % CAPACITY]);
+		_tail.store(tail + 1, std::memory_order_release);
+		return true;
+	}
+private:
+	// Keep producer and consumer index on separate cache lines.
+	std::atomic<size_t> _head;
+	char _headPadding[64 - sizeof(std::atomic<size_t>)];
+	std::atomic<size_t> _tail;
+	char _tailPadding[64 - sizeof(std::atomic<size_t>)];
+	std::array<T, CAPACITY> _slots;
+};
+
+struct ProgressEvent {
+	enum class Kind {
+		VALID_CHECKS,
+		ITERATIONS,
+		SOLUTION
+	};
+	Kind kind;
+	size_t count;
+	size_t crosses;
+	CrosswordPuzzle puzzle;
+};
+
+// Collects progress of several search workers, one ring per worker, and
+// prints it from a background reporter thread. It also carries the
+// cancellation flag that the searches poll through their tracers.
+class ProgressChannel {
+public:
+	using Ring = SingleProducerRing<ProgressEvent, 256>;
+
+	ProgressChannel(size_t numberOfWorkers, std::ostream& out = std::cout)
+	: _out(out), _cancelled(false), _stopped(false) {
+		for (size_t i=0; i<numberOfWorkers; i++) {
+			_rings.emplace_back(new Ring());
+		}
+		_reporter = std::thread([this]() {
+			while (!_stopped.load(std::memory_order_acquire)) {
+				drain();
+				std::this_thread::sleep_for(std::chrono::milliseconds(10));
+			}
+			drain();
+		});
+	}
+	ProgressChannel(const ProgressChannel&) = delete;
+	ProgressChannel& operator=(const ProgressChannel&) = delete;
+	~ProgressChannel() {
+		stop();
+	}
+	// Waits until the reporter has printed all pending events.
+	void stop() {
+		if (_reporter.joinable()) {
+			_stopped.store(true, std::memory_order_release);
+			_reporter.join();
+		}
+	}
+	void cancel() {
+		_cancelled.store(true, std::memory_order_relaxed);
+	}
+	const std::atomic<bool>& cancelled() const {
+		return _cancelled;
+	}
+	const std::atomic<bool>& stopped() const {
+		return _stopped;
+	}
+	Ring& ring(size_t worker) {
+		return *_rings[worker];
+	}
+	size_t numberOfWorkers() const {
+		return _rings.size();
+	}
+private:
+	void drain() {
+		ProgressEvent event;
+		for (size_t i=0; i<_rings.size(); i++) {
+			while (_rings[i]->pop(event)) {
+				if (_rings.size() > 1) {
+					_out << "Worker " << i << ": ";
+				}
+				switch (event.kind) {
+				case ProgressEvent::Kind::VALID_CHECKS:
+				case ProgressEvent::Kind::ITERATIONS:
+					_out << "Searched " << event.count << " variants.\n";
+					break;
+				case ProgressEvent::Kind::SOLUTION:
+					_out << "Found solution (";
+					_out << event.crosses << " crosses, iterations=";
+					_out << event.count << "):\n";
+					_out << "===============\n";
+					event.puzzle.render(_buffer);
+					_out << _buffer << '\n';
+					_out << "===============\n";
+					break;
+				}
+			}
+		}
+		_out.flush();
+	}
+
+	std::ostream& _out;
+	std::vector<std::unique_ptr<Ring>> _rings;
+	std::atomic<bool> _cancelled;
+	std::atomic<bool> _stopped;
+	std::thread _reporter;
+	std::string _buffer;
+};
+
+// Progress tracer of one worker of a ProgressChannel. Counting is local,
+// only every 100000th valid check or 100th iteration and every solution is
+// handed to the ring. Progress is dropped when the ring is full, solutions
+// wait for the reporter. Once the channel is stopped nothing is reported
+// anymore, and solutions that do not fit into the ring are dropped too.
+class ChannelProgressTracer {
+public:
+	ChannelProgressTracer(ProgressChannel& channel, size_t worker)
+	: _ring(&channel.ring(worker)), _cancelled(&channel.cancelled()),
+	  _stopped(&channel.stopped()), _numberOfValidChecks(0) {
+	}
+	void validCheck(const CrosswordPuzzle& puzzleOld,
+			const CrosswordPuzzle& puzzleNew, const std::string& word) {
+		_numberOfValidChecks++;
+		if (_numberOfValidChecks % 100000 == 0) {
+			ProgressEvent event{ProgressEvent::Kind::VALID_CHECKS,
+				_numberOfValidChecks, 0, CrosswordPuzzle()};
+			_ring->push(event);
+		}
+	}
+	void foundSolution(const CrosswordPuzzle& puzzle, size_t crosses,
+			size_t iterations) {
+		ProgressEvent event{ProgressEvent::Kind::SOLUTION, iterations,
+			crosses, puzzle};
+		while (!_ring->push(event)) {
+			if (_stopped->load(std::memory_order_acquire)) {
+				return;
+			}
+			std::this_thread::yield();
+		}
+	}
+	void nextIteration(size_t n) {
+		if (n % 100 == 0 && n != 0) {
+			ProgressEvent event{ProgressEvent::Kind::ITERATIONS, n, 0,
+				CrosswordPuzzle()};
+			_ring->push(event);
+		}
+	}
+	bool cancelled() const {
+		return _cancelled->load(std::memory_order_relaxed);
+	}
+	size_t numberOfValidChecks() const {
+		return _numberOfValidChecks;
+	}
+private:
+	ProgressChannel::Ring* _ring;
+	const std::atomic<bool>* _cancelled;
+	const std::atomic<bool>* _stopped;
+	size_t _numberOfValidChecks;
+};
+
+// Forwards to a ChannelProgressTracer and cancels its channel from inside the
+// search after a given number of valid checks.
+class CancellingProgressTracer {
+public:
+	CancellingProgressTracer(ProgressChannel& channel,
+			size_t cancelAfterValidChecks)
+	: _channel(channel), _pt(channel, 0),
+	  _cancelAfterValidChecks(cancelAfterValidChecks) {
+	}
+	void validCheck(const CrosswordPuzzle& puzzleOld,
+			const CrosswordPuzzle& puzzleNew, const std::string& word) {
+		_pt.validCheck(puzzleOld, puzzleNew, word);
+		if (_pt.numberOfValidChecks() == _cancelAfterValidChecks) {
+			_channel.cancel();
+		}
+	}
+	void foundSolution(const CrosswordPuzzle& puzzle, size_t crosses,
+			size_t iterations) {
+		_pt.foundSolution(puzzle, crosses, iterations);
+	}
+	void nextIteration(size_t n) {
+		_pt.nextIteration(n);
+	}
+	bool cancelled() const {
+		return _pt.cancelled();
+	}
+	size_t numberOfValidChecks() const {
+		return _pt.numberOfValidChecks();
+	}
+private:
+	ProgressChannel& _channel;
+	ChannelProgressTracer _pt;
+	size_t _cancelAfterValidChecks;
+};
+
+void test_progressChannel() {
+	using Direction = Crossword::Direction;
+	SingleProducerRing<int, 4> ring;
+	for (int i=0; i<4; i++) {
+		assertTrue("ring accepts values until full", ring.push(i));
+	}
+	int value = 4;
+	assertTrue("ring reports full at capacity", !ring.push(value));
+	for (int i=0; i<4; i++) {
+		assertTrue("ring keeps FIFO order", ring.pop(value) && value == i);
+	}
+	assertTrue("ring is empty after popping all", !ring.pop(value));
+
+	CrosswordPuzzle puzzle = {
+			{"MAIWANDERUNG", 0, 4, Direction::HORIZONTAL},
+			{"NEUN", 10, 4, Direction::VERTICAL},
+			{"SONNE", 5, 2, Direction::VERTICAL},
+	};
+	std::ostringstream out;
+	ProgressChannel progressChannel(1, out);
+	ChannelProgressTracer progressTracer(progressChannel, 0);
+	progressTracer.nextIteration(100);
+	progressTracer.foundSolution(puzzle, 2, 7);
+	progressChannel.stop();
+	assertTrue("stop() flushes pending progress",
+			out.str().find("Searched 100 variants.\n") != std::string::npos);
+	assertTrue("reporter renders solutions", out.str().find(
+			"Found solution (2 crosses, iterations=7):\n"
+			"===============\n" + puzzle.toString()) != std::string::npos);
+	for (size_t i=0; i<ProgressChannel::Ring::CAPACITY + 1; i++) {
+		progressTracer.foundSolution(puzzle, 2, i);
+	}
+
+	const std::vector<std::string>& words5 = FIVE_WORDS;
+	std::vector<std::string> words2 = {"AB", "BA"};
+	ProgressChannel cancelledChannel(1, out);
+	ChannelProgressTracer cancelledTracer(cancelledChannel, 0);
+	cancelledChannel.cancel();
+	assertTrue("cancelled findPuzzles returns immediately",
+			findPuzzles(words5, 4, 1, cancelledTracer).empty() &&
+			cancelledTracer.numberOfValidChecks() == 0);
+	assertTrue("cancelled Sica1 returns immediately",
+			findCrosswordPuzzlesBySica1(words5, 4, 100000,
+					cancelledTracer).empty());
+	assertTrue("cancelled brute force returns immediately",
+			findCrosswordPuzzlesByBruteForce(words2, 1, 100,
+					cancelledTracer).empty());
+
+	// The 9-word list needs far more than 1000 valid checks for a puzzle.
+	const std::vector<std::string>& words9 = NINE_WORDS;
+	ProgressChannel runningChannel(1, out);
+	CancellingProgressTracer runningTracer(runningChannel, 1000);
+	std::vector<CrosswordPuzzle> found =
+			findPuzzles(words9, 10, 1, runningTracer);
+	assertTrue("running findPuzzles returns nothing after cancel()",
+			found.empty() && runningChannel.cancelled());
+	// At most the remaining offsets of the word being placed are checked.
+	size_t maxLength = 0;
+	for (const std::string& word : words9) {
+		maxLength = std::max(maxLength, word.length());
+	}
+	assertTrue("running findPuzzles stops checking after cancel()",
+			runningTracer.numberOfValidChecks() <= 1000 + maxLength);
+	runningChannel.stop();
+}
+
+void test_parallelBruteForce() {
+	std::vector<std::string> words = {"AB", "BA"};
+	std::ostringstream out;
+	ProgressChannel progressChannel(2, out);
+	std::vector<ChannelProgressTracer> progressTracers;
+	for (size_t i=0; i<progressChannel.numberOfWorkers(); i++) {
+		progressTracers.emplace_back(progressChannel, i);
+	}
+	std::set<CrosswordPuzzle> found =
+			findCrosswordPuzzlesByParallelBruteForce(words, 1, 100,
+					progressTracers);
+	assertTrue("parallel brute force finds all four crossings",
+			found.size() == 4);
+	for (const CrosswordPuzzle& puzzle : found) {
+		assertTrue("parallel brute force fixes first word at origin",
+				puzzle[0].xStart() == 0 && puzzle[0].yStart() == 0);
+	}
+	found = findCrosswordPuzzlesByParallelBruteForce(words, 1, 3,
+			progressTracers);
+	assertTrue("parallel brute force honors maxMatches", found.size() == 3);
+}
+
+#ifdef CROSSWORD_PROFILE
+// Runs fixed workloads with the 5-, 9- and 20-word lists and writes the
+// time spent in the profiled scopes as folded stacks to the given file.
+void profileWorkloads(const std::string& path) {
+	const std::vector<std::string>& words5 = FIVE_WORDS;
+	const std::vector<std::string>& words9 = NINE_WORDS;
+	const std::vector<std::string>& words20 = TWENTY_WORDS;
+	std::ostringstream progress;
+	ProgressChannel progressChannel(1, progress);
+	ChannelProgressTracer progressTracer(progressChannel, 0);
+	{
+		PROFILE_SCOPE("sica1-5");
+		findCrosswordPuzzlesBySica1(words5, 4, 100000, progressTracer);
+	}
+	{
+		PROFILE_SCOPE("findPuzzles-9-15x15");
+		findPuzzles(words9, 10, 1, BoundedGrid(15, 15), progressTracer);
+	}
+	{
+		PROFILE_SCOPE("randomized-9");
+		findPuzzleRandomized(words9, 10, 0, progressTracer);
+	}
+	{
+		PROFILE_SCOPE("randomized-20");
+		findPuzzleRandomized(words20, 10, 0, progressTracer);
+	}
+	progressChannel.stop();
+	std::ofstream out(path);
+	Profiler::instance().writeFolded(out);
+	std::cout << "Wrote profile to " << path << '\n';
+}
+#endif
+
+void test_seedTasks() {
+	std::vector<std::string> words = {"MAIWANDERUNG", "NEUN", "SONNE",
+			"NEUN"};
+	std::vector<SeedTask> tasks = seedTasks(words, UnboundedGrid());
+	assertTrue("seedTasks() skips duplicate words and transposed seeds",
+			tasks.size() == 3);
+	for (const SeedTask& task : tasks) {
+		assertTrue("seedTasks() starts horizontal",
+				task.puzzle[0].direction() ==
+						WordWithDirection::Direction::HORIZONTAL);
+		assertTrue("seedTasks() keeps the remaining words",
+				task.remainingWords.size() == 3);
+	}
+	tasks = seedTasks(words, BoundedGrid(12, 8));
+	assertTrue("seedTasks() adds vertical seeds that fit a non-square grid",
+			tasks.size() == 5);
+}
+
+void test_findPuzzlesParallel() {
+	const std::vector<std::string>& words = FIVE_WORDS;
+	std::vector<SimpleProgressTracer> progressTracers(2);
+	std::vector<CrosswordPuzzle> found = findPuzzlesParallel(words, 4, 3,
+			UnboundedGrid(), progressTracers);
+	assertTrue("findPuzzlesParallel() honors minPuzzles", found.size() == 3);
+	for (const CrosswordPuzzle& puzzle : found) {
+		assertTrue("findPuzzlesParallel() finds complete valid puzzles",
+				puzzle.size() == words.size() && puzzle.valid() &&
+				puzzle.crosses() >= 4);
+	}
+}
+
+int main() {
+#ifdef CROSSWORD_PROFILE
+	// Skip the tests, their searches would end up in the profile.
+	profileWorkloads("crossword.folded");
+	return 0;
+#endif
+	size_t numberOfFailedTests = 0;
+	try {
+		test_toString();
+	} catch (const TestFailed& e) {
+		std::cerr << e.what() << '\n';
+		numberOfFailedTests++;
+	}
+	try {
+		test_render();
+	} catch (const TestFailed& e) {
+		std::cerr << e.what() << '\n';
+		numberOfFailedTests++;
+	}
+	try {
+		test_valid();
+	} catch (const TestFailed& e) {
+		std::cerr << e.what() << '\n';
+		numberOfFailedTests++;
+	}
+	try {
+		test_boundedGrid();
+	} catch (const TestFailed& e) {
+		std::cerr << e.what() << '\n';
+		numberOfFailedTests++;
+	}
+	try {
+		test_randomized();
+	} catch (const TestFailed& e) {
+		std::cerr << e.what() << '\n';
+		numberOfFailedTests++;
+	}
+	try {
+		test_dictionary();
+	} catch (const TestFailed& e) {
+		std::cerr << e.what() << '\n';
+		numberOfFailedTests++;
+	}
+	try {
+		test_solutionCounter();
+	} catch (const TestFailed& e) {
+		std::cerr << e.what() << '\n';
+		numberOfFailedTests++;
+	}
+	try {
+		test_progressChannel();
+	} catch (const TestFailed& e) {
+		std::cerr << e.what() << '\n';
+		numberOfFailedTests++;
+	}
+	try {
+		test_parallelBruteForce();
+	} catch (const TestFailed& e) {
+		std::cerr << e.what() << '\n';
+		numberOfFailedTests++;
+	}
+	try {
+		test_seedTasks();
+	} catch (const TestFailed& e) {
+		std::cerr << e.what() << '\n';
+		numberOfFailedTests++;
+	}
+	try {
+		test_findPuzzlesParallel();
+	} catch (const TestFailed& e) {
+		std::cerr << e.what() << '\n';
+		numberOfFailedTests++;
+	}
+	if (numberOfFailedTests > 0) {
+		std::cerr << numberOfFailedTests << " test failed.\n";
+	} else {
+		std::cout << "All tests successful.\n";
+	}
+	auto start = std::chrono::steady_clock::now();
+//	const std::vector<std::string>& words = TWENTY_WORDS;
+	const std::vector<std::string>& words = NINE_WORDS;
+//	std::set<CrosswordPuzzle> foundCrosswords =
+//			findCrosswordPuzzlesBySica1<CrosswordProgressPrinter>(
+//					words, 22, 100000);
+//	const std::vector<std::string>& words = FIVE_WORDS;
+//	std::set<CrosswordPuzzle> foundCrosswords =
+//			findCrosswordPuzzlesBySica1<CrosswordProgressPrinter>(
+//					words, 4, 100000);
+//	std::cout << "Found " << foundCrosswords.size() << " matching puzzles.\n";
+//	SimpleProgressTracer progressTracer;
+//	auto foundPuzzles = findPuzzles(words, 10, 1, progressTracer);
+	ProgressChannel progressChannel(
+			std::max(1u, std::thread::hardware_concurrency()));
+	std::vector<ChannelProgressTracer> progressTracers;
+	for (size_t i=0; i<progressChannel.numberOfWorkers(); i++) {
+		progressTracers.emplace_back(progressChannel, i);
+	}
+	size_t winningSeed = 0;
+	auto foundPuzzles = findPuzzleByPortfolio(words, 10, 0, progressTracers,
+			winningSeed);
+	progressChannel.stop();
+	size_t numberOfValidChecks = 0;
+	for (const ChannelProgressTracer& progressTracer : progressTracers) {
+		numberOfValidChecks += progressTracer.numberOfValidChecks();
 	}
-	auto start = std::chrono::steady_clock::now();
-//	std::vector<std::string> words = {"DEHNEN", "NIKOLAUS", "NEUREUTHER",
-//			"SOELDEN", "RUNDLAUF", "DREI", "HOCKE", "BUEGELEISEN", "FIS",
-//	        "HUENDLE", "STELLER", "MAIWANDERUNG", "MARKUS", "ELENA", "PETRA",
-//	        "XAVER", "XELSBOCK", "SYSTEM", "ROLLADEN", "BUCH"};
-	std::vector<std::string> words = {"DEHNEN", "NIKOLAUS", "NEUREUTHER",
-			"SOELDEN", "RUNDLAUF", "DREI", "HOCKE", "BUEGELEISEN", "FIS"};
-//	std::set<CrosswordPuzzle> foundCrosswords =
-//			findCrosswordPuzzlesBySica1<CrosswordProgressPrinter>(
-//					words, 22, 100000);
-//	std::vector<std::string> words = {"MAIWANDERUNG", "NEUN", "SONNE", "RADWEG",
-//			"BAZAR"};
-//	std::set<CrosswordPuzzle> foundCrosswords =
-//			findCrosswordPuzzlesBySica1<CrosswordProgressPrinter>(
-//					words, 4, 100000);
-//	std::cout << "Found " << foundCrosswords.size() << " matching puzzles.\n";
-	SimpleProgressTracer progressTracer;
-	auto foundPuzzles = findPuzzles(words, 10, 1, progressTracer);
 	auto end = std::chrono::steady_clock::now();
 	std::chrono::duration<double> elapsed_seconds = end-start;
 	for (CrosswordPuzzle puzzle : foundPuzzles) {
@@ -860,6 +2531,7 @@ int main() {
 		std::cout << puzzle.toString() << "\n";
 	}
 	std::cout << "Found " << foundPuzzles.size() << " puzzles\n";
-	std::cout << "Tried " << progressTracer.numberOfValidChecks() << " variants\n";
+	std::cout << "Winning seed " << winningSeed << "\n";
+	std::cout << "Tried " << numberOfValidChecks << " variants\n";
 	std::cout << "Elapsed time: " << elapsed_seconds.count() << "s\n";
 }